@@ -13,6 +13,8 @@
 #include <fcntl.h>
 #include <assert.h>
 
+#include "trace.h"
+
 
 static ssize_t getpath(int fd, char *dst, size_t dst_size, mode_t *out_mode);
 
@@ -59,7 +61,7 @@ ssize_t getdirpath(int dirfd, char *dst, size_t dst_size) {
 
 
 static
-ssize_t getpath(int fd, char *dst, size_t dst_size, mode_t *out_mode) {
+ssize_t getpath_impl(int fd, char *dst, size_t dst_size, mode_t *out_mode) {
     if (!dst || dst_size == 0) {
         errno = EINVAL;
         return -1;
@@ -105,3 +107,11 @@ ssize_t getpath(int fd, char *dst, size_t dst_size, mode_t *out_mode) {
     // unlike read, write, which include any terminal NUL
     return (ssize_t)res_len;
 }
+
+static
+ssize_t getpath(int fd, char *dst, size_t dst_size, mode_t *out_mode) {
+    PROBE1(getpath_entry, fd);
+    ssize_t result = getpath_impl(fd, dst, dst_size, out_mode);
+    PROBE3(getpath_return, result, errno, dst);
+    return result;
+}
@@ -1,4 +1,4 @@
-// #define _GNU_SOURCE
+#define _GNU_SOURCE
 #include <string.h>
 #include <errno.h>
 #include <limits.h>
@@ -7,23 +7,137 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <assert.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#if __has_include(<linux/openat2.h>)
+#include <linux/openat2.h>
+#endif
+#endif
 
-#include <stdio.h>
+#include "normpath.h"
+#include "trace.h"
+
+#ifndef O_PATH
+#define O_PATH O_RDONLY
+#endif
 
 // when enabled, skips all validation of 'existing' when 'soft' starts with '/'
 #define ABSOLUTE_SOFT_SHORT_CIRCUITS 0
 
 extern ssize_t getdirpath(int dirfd, char *dst, size_t dst_size);
-extern ssize_t resolve(int dirfd, const char *restrict src, int force_slash, int *can_soft, int want_absolute, char *restrict dst, size_t cursor, size_t dst_size);
+extern ssize_t resolve(int dirfd, const char *restrict src, int force_slash, int *can_soft, size_t *soft_at, size_t *covered, int want_absolute, const char *dirpath, char *restrict dst, size_t cursor, size_t dst_size);
+
+
+/*
+ * streaming 64-bit hash in the style of wyhash: 8-byte words folded in with a 128-bit multiply
+ * the result depends only on the bytes, not on how they were split across hash_update calls
+ */
+#define HASH_SEED 0xa0761d6478bd642fULL
+#define HASH_P1 0xe7037ed1a0b428dbULL
+#define HASH_P2 0x8ebc6af09c88c6e3ULL
+
+struct hasher {
+    unsigned long long h;
+    unsigned long long word; // pending bytes, little-endian
+    unsigned pending;
+    size_t len;
+};
+
+// xor of the high and low halves of the 128-bit product a * b
+static inline unsigned long long hash_mix(unsigned long long a, unsigned long long b) {
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = (__uint128_t)a * b;
+    return (unsigned long long)r ^ (unsigned long long)(r >> 64);
+#else
+    // 32-bit targets: schoolbook multiply on 32-bit halves
+    unsigned long long a_lo = a & 0xffffffffULL, a_hi = a >> 32;
+    unsigned long long b_lo = b & 0xffffffffULL, b_hi = b >> 32;
+    unsigned long long lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo;
+    unsigned long long lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+    unsigned long long cross = (lo_lo >> 32) + (hi_lo & 0xffffffffULL) + lo_hi;
+    unsigned long long hi = hi_hi + (hi_lo >> 32) + (cross >> 32);
+    unsigned long long lo = (cross << 32) | (lo_lo & 0xffffffffULL);
+    return lo ^ hi;
+#endif
+}
+
+static void hash_update(struct hasher *hs, const char *src, size_t n) {
+    const unsigned char *s = (const unsigned char *)src;
+    hs->len += n;
+    while (n && hs->pending) {
+        hs->word |= (unsigned long long)*s++ << (8 * hs->pending);
+        n--;
+        if (++hs->pending == 8) {
+            hs->h = hash_mix(hs->word ^ HASH_P1, hs->h ^ HASH_P2);
+            hs->word = 0;
+            hs->pending = 0;
+        }
+    }
+    for (; n >= 8; s += 8, n -= 8) {
+        unsigned long long w = 0;
+        for (int i = 0; i < 8; i++) w |= (unsigned long long)s[i] << (8 * i);
+        hs->h = hash_mix(w ^ HASH_P1, hs->h ^ HASH_P2);
+    }
+    for (; n; n--) hs->word |= (unsigned long long)*s++ << (8 * hs->pending++);
+}
+
+static unsigned long long hash_final(const struct hasher *hs) {
+    return hash_mix(hs->h ^ hs->word ^ HASH_P1, (unsigned long long)hs->len ^ HASH_P2);
+}
 
+static void digest_component(struct normpath_digest *digest, size_t offset) {
+    if (digest->components < digest->offsets_cap) digest->offsets[digest->components] = offset;
+    digest->components++;
+}
+
+/*
+ * a digest being filled in as its path is written
+ * base is where the writer's buffer sits in the final dst, for component offsets
+ */
+struct digest_stream {
+    struct hasher hs;
+    struct normpath_digest *digest;
+    size_t base;
+};
+
+static void digest_start(struct digest_stream *ds, struct normpath_digest *digest) {
+    struct hasher hs = { HASH_SEED, 0, 0, 0 };
+    ds->hs = hs;
+    ds->digest = digest;
+    ds->base = 0;
+    digest->components = 0;
+}
+
+// digests dst[from, to), which must already be in its final place
+static void digest_span(struct digest_stream *ds, const char *dst, size_t from, size_t to) {
+    hash_update(&ds->hs, &dst[from], to - from);
+    for (size_t i = from; i < to; i++) {
+        if (dst[i] != '/' && (i == 0 || dst[i - 1] == '/')) digest_component(ds->digest, i);
+    }
+}
+
+static void digest_finish(struct digest_stream *ds) {
+    ds->digest->hash = hash_final(&ds->hs);
+}
+
+// first byte normal() would write for src, or '\0' if it would write nothing
+static char normal_first(const char *s) {
+    if (*s == '/') return '/';
+    while (s[0] == '.' && (s[1] == '/' || s[1] == '\0')) {
+        s++;
+        while (*s == '/') s++;
+    }
+    return *s;
+}
 
 /*
  * expects src ends with \0
  * accepts ""
  * does not write \0 to dst, but fails if there's no space for it
  * returns # bytes written >= 0
+ * if ds is non-NULL, feeds it the bytes as they are written
  */
-extern ssize_t normal(const char *src, int force_slash, char *dst, size_t dst_size) {
+static ssize_t normal_impl(const char *src, int force_slash, char *dst, size_t dst_size, struct digest_stream *ds) {
     assert(src && dst && dst_size > 0 && dst_size <= SSIZE_MAX);
     // assert(dst_size <= PATH_MAX);
 
@@ -39,6 +153,7 @@ extern ssize_t normal(const char *src, int force_slash, char *dst, size_t dst_si
         if (1 >= dst_left) goto toolong;
         *d++ = '/';
         dst_left--;
+        if (ds) hash_update(&ds->hs, "/", 1);
     }
 
     while (*s) {
@@ -51,6 +166,7 @@ extern ssize_t normal(const char *src, int force_slash, char *dst, size_t dst_si
                 if (1 >= dst_left) goto toolong;
                 *d++ = '/';
                 dst_left--;
+                if (ds) hash_update(&ds->hs, "/", 1);
             }
             first = 0;
             // scan component
@@ -62,6 +178,10 @@ extern ssize_t normal(const char *src, int force_slash, char *dst, size_t dst_si
 
             if (comp_len >= dst_left) goto toolong;
             memcpy(d, comp_start, comp_len);
+            if (ds) {
+                digest_component(ds->digest, ds->base + (size_t)(d - dst));
+                hash_update(&ds->hs, comp_start, comp_len);
+            }
             d += comp_len;
             dst_left -= comp_len;
         }
@@ -80,6 +200,7 @@ extern ssize_t normal(const char *src, int force_slash, char *dst, size_t dst_si
                 if (1 >= dst_left) goto toolong;
                 *d++ = '/';
                 dst_left--;
+                if (ds) hash_update(&ds->hs, "/", 1);
             } else {
                 assert(dst_size - dst_left == 1);
             }
@@ -93,6 +214,40 @@ toolong:
     errno = ENAMETOOLONG; return -1;
 }
 
+extern ssize_t normal(const char *src, int force_slash, char *dst, size_t dst_size) {
+    return normal_impl(src, force_slash, dst, dst_size, 0);
+}
+
+ssize_t normal_digest(const char *src, int force_slash, char *dst, size_t dst_size, struct normpath_digest *digest) {
+    if (!digest || (digest->offsets_cap && !digest->offsets)) { errno = EINVAL; return -1; }
+    struct digest_stream ds;
+    digest_start(&ds, digest);
+    ssize_t result = normal_impl(src, force_slash, dst, dst_size, &ds);
+    if (result >= 0) digest_finish(&ds);
+    return result;
+}
+
+/*
+ * what dual_normpath works out once for both of its traversals
+ * force_slash is check_existing's result; dirpath is getdirpath(dirfd), or NULL if not fetched
+ * covered is how many leading components of soft the physical walk looked up on the logical
+ * pass's behalf (see resolve); those need no directory check of their own
+ */
+struct shared {
+    int force_slash;
+    const char *dirpath;
+    size_t dirpath_len;
+    size_t covered;
+};
+
+// getdirpath, unless shared already has it
+static ssize_t shared_dirpath(int dirfd, const struct shared *shared, char *dst, size_t dst_size) {
+    if (!shared || !shared->dirpath) return getdirpath(dirfd, dst, dst_size);
+    if (shared->dirpath_len >= dst_size) { errno = ENAMETOOLONG; return -1; }
+    memcpy(dst, shared->dirpath, shared->dirpath_len + 1);
+    return (ssize_t)shared->dirpath_len;
+}
+
 /*
  * logical_normpath contract for existing path validation:
  * - Path existing must be lstat-able, i.e., it must name a valid filesystem object.
@@ -102,7 +257,61 @@ toolong:
  *   If that stat fails or points to a non-directory, we fail.
  */
 
-ssize_t logical_normpath(int dirfd, const char *existing, const char *soft, int want_absolute, char *dst, size_t dst_size) {
+/*
+ * validates existing per the contract above
+ * returns 1 if existing names (or is a symlink to) a directory, else 0, or -1 on failure
+ * when a symlink is accepted without being followed, sets *dangling (if non-NULL)
+ * and leaves errno as set by the failed stat
+ */
+static int check_existing(int dirfd, const char *existing, const char *soft, int *dangling) {
+    int force_slash = 0;
+    size_t existing_len = strlen(existing);
+    assert(existing_len > 0);
+    struct stat existing_stat;
+    if (fstatat(dirfd, existing, &existing_stat, AT_SYMLINK_NOFOLLOW) != 0) {
+        // "link_loop/." or "link_dangling/[.]"
+        return -1;
+    }
+    if (S_ISLNK(existing_stat.st_mode)) {
+        if (fstatat(dirfd, existing, &existing_stat, 0) == 0) {
+            force_slash = S_ISDIR(existing_stat.st_mode);
+        } else if (soft) {
+            // "link_loop" "." or "link_dangling" "."
+            // also "link_loop/" "." on Darwin
+            return -1;
+        } else {
+            // else force_slash remains 0
+#if defined(__APPLE__) && defined(__MACH__)
+            if (existing[existing_len - 1] == '/') {
+                // "link_loop/" on Darwin
+                assert(errno == ELOOP);
+                return -1;
+            } else
+#endif
+            {
+                // dangling or looping symlink, but not trying to resolve it
+                if (dangling) *dangling = 1;
+            }
+        }
+    } else {
+        force_slash = S_ISDIR(existing_stat.st_mode);
+#if defined(__APPLE__) && defined(__MACH__)
+        if (!force_slash && existing[existing_len - 1] == '/') {
+            // "link_file/" on Darwin
+            errno = ENOTDIR; return -1;
+        }
+#endif
+    }
+    assert(existing[existing_len - 1] != '/' || force_slash == 1);
+    if (soft && !force_slash) { errno = ENOTDIR; return -1; }
+    return force_slash;
+}
+
+/*
+ * if ds is non-NULL, feeds it dst as each piece is written
+ * pieces are never moved afterwards: a leading ./ is written only if it will stay
+ */
+static ssize_t logical_normpath_impl(int dirfd, const char *existing, const char *soft, int want_absolute, char *dst, size_t dst_size, const struct shared *shared, struct digest_stream *ds) {
     if (!dst || dst_size == 0 || dst_size > PATH_MAX || dst_size > SSIZE_MAX) { errno = EINVAL; return -1; }
     if (!existing && !soft) { errno = EINVAL; return -1; }
     // TODO consider whether next two checks can be relaxed
@@ -114,49 +323,12 @@ ssize_t logical_normpath(int dirfd, const char *existing, const char *soft, int
         if (!soft_absolute)
 #endif
         {
-            int force_slash = 0;
-            size_t existing_len = strlen(existing);
-            assert(existing_len > 0);
-            struct stat existing_stat;
-            if (fstatat(dirfd, existing, &existing_stat, AT_SYMLINK_NOFOLLOW) != 0) {
-                // "link_loop/." or "link_dangling/[.]"
-                return -1;
-            }
-            if (S_ISLNK(existing_stat.st_mode)) {
-                if (fstatat(dirfd, existing, &existing_stat, 0) == 0) {
-                    force_slash = S_ISDIR(existing_stat.st_mode);
-                } else if (soft) {
-                    // "link_loop" "." or "link_dangling" "."
-                    // also "link_loop/" "." on Darwin
-                    return -1;
-                } else {
-                    // else force_slash remains 0
-#if defined(__APPLE__) && defined(__MACH__)
-                    if (existing[existing_len - 1] == '/') {
-                        // "link_loop/" on Darwin
-                        assert(errno == ELOOP);
-                        return -1;
-                    } else
-#endif
-                    {
-                        // dangling or looping symlink, but not trying to resolve it
-                    }
-                }
-            } else {
-                force_slash = S_ISDIR(existing_stat.st_mode);
-#if defined(__APPLE__) && defined(__MACH__)
-                if (!force_slash && existing[existing_len - 1] == '/') {
-                    // "link_file/" on Darwin
-                    errno = ENOTDIR; return -1;
-                }
-#endif
-            }
-            assert(existing[existing_len - 1] != '/' || force_slash == 1);
-            if (soft && !force_slash) { errno = ENOTDIR; return -1; }
+            int force_slash = shared ? shared->force_slash : check_existing(dirfd, existing, soft, 0);
+            if (force_slash < 0) return -1;
             if (!soft_absolute) {
                 if (existing[0] != '/') {
                     if (want_absolute) {
-                        ssize_t path_len = getdirpath(dirfd, dst, dst_size);
+                        ssize_t path_len = shared_dirpath(dirfd, shared, dst, dst_size);
                         if (path_len < 0) return -1;
                         cursor = (size_t)path_len;
                         assert(0 < cursor && cursor < dst_size);
@@ -164,13 +336,21 @@ ssize_t logical_normpath(int dirfd, const char *existing, const char *soft, int
                             if (cursor + 1 >= dst_size) goto toolong;
                             dst[cursor++] = '/';
                         }
-                    } else if (existing[0] == '-' || (existing[0] == '.' && existing[1] == '/')) {
-                        if (2 >= dst_size) goto toolong;
-                        dst[cursor++] = '.';
-                        dst[cursor++] = '/';
+                        if (ds) digest_span(ds, dst, 0, cursor);
+                    } else {
+                        // ./ is needed only to keep a leading - from reading as an option
+                        char lead = normal_first(existing);
+                        if (!lead && soft) lead = normal_first(soft);
+                        if (lead == '-') {
+                            if (2 >= dst_size) goto toolong;
+                            dst[cursor++] = '.';
+                            dst[cursor++] = '/';
+                            if (ds) digest_span(ds, dst, 0, cursor);
+                        }
                     }
                 }
-                ssize_t normal_len = normal(existing, force_slash, &dst[cursor], dst_size - cursor);
+                if (ds) ds->base = cursor;
+                ssize_t normal_len = normal_impl(existing, force_slash, &dst[cursor], dst_size - cursor, ds);
                 if (normal_len < 0) return -1;
                 cursor += (size_t) normal_len;
             }
@@ -178,7 +358,7 @@ ssize_t logical_normpath(int dirfd, const char *existing, const char *soft, int
     } /* if (existing) */
     else if (soft[0] != '/') {
         if (want_absolute) {
-            ssize_t path_len = getdirpath(dirfd, dst, dst_size);
+            ssize_t path_len = shared_dirpath(dirfd, shared, dst, dst_size);
             if (path_len < 0) return -1;
             cursor = (size_t)path_len;
             assert(0 < cursor && cursor < dst_size);
@@ -186,6 +366,7 @@ ssize_t logical_normpath(int dirfd, const char *existing, const char *soft, int
                 if (cursor + 1 >= dst_size) goto toolong;
                 dst[cursor++] = '/';
             }
+            if (ds) digest_span(ds, dst, 0, cursor);
         }
     }
 
@@ -193,15 +374,17 @@ ssize_t logical_normpath(int dirfd, const char *existing, const char *soft, int
         dst[cursor] = '\0';
     } else {
         if (cursor == 0) {
-            if (soft[0] == '-' || (soft[0] == '.' && soft[1] == '/')) {
+            if (normal_first(soft) == '-') {
                 if (2 >= dst_size) goto toolong;
                 dst[cursor++] = '.';
                 dst[cursor++] = '/';
+                if (ds) digest_span(ds, dst, 0, cursor);
             }
         }
 
         char *check = dst + cursor; // &dst[cursor]
-        ssize_t soft_len = normal(soft, 0, check, dst_size - cursor);
+        if (ds) ds->base = cursor;
+        ssize_t soft_len = normal_impl(soft, 0, check, dst_size - cursor, ds);
         if (soft_len < 0) return -1;
         cursor += (size_t)soft_len;
         char *end = dst + cursor;
@@ -209,6 +392,7 @@ ssize_t logical_normpath(int dirfd, const char *existing, const char *soft, int
 
         // validate all intermediate soft components used as directories
         int checking = 1;
+        size_t checked = 0;
         if (*check == '/') {
             assert(soft_absolute);
             check++;
@@ -218,6 +402,8 @@ ssize_t logical_normpath(int dirfd, const char *existing, const char *soft, int
             // skip checking final components that don't end with /
             if (check == end) break;
             check++;
+            // the physical walk of dual_normpath already looked these up
+            if (shared && checked++ < shared->covered) continue;
             char sep = *check;
             *check = '\0';
             struct stat check_stat;
@@ -242,15 +428,12 @@ ssize_t logical_normpath(int dirfd, const char *existing, const char *soft, int
         } // while (checking)
     } // if (soft)
 
-    // we include case where dst[2] == '\0'
-    if (cursor >= 2 && dst[0] == '.' && dst[1] == '/' && dst[2] != '-') {
-        memmove(dst, &dst[2], cursor - 1);
-        cursor -= 2;
-    }
+    assert(!(cursor >= 2 && dst[0] == '.' && dst[1] == '/' && dst[2] != '-'));
     if (cursor == 0) {
         if (1 >= dst_size) goto toolong;
         dst[cursor++] = '.'; // TODO we render (any trailing) .. as ../, should we render (bare) . the same?
         dst[cursor] = '\0';
+        if (ds) digest_span(ds, dst, 0, cursor);
     }
     assert(cursor < dst_size);
     assert(dst[cursor] == '\0');
@@ -261,12 +444,18 @@ toolong:
 }
 
 
-ssize_t physical_normpath(int dirfd, const char *existing, const char *soft, int want_absolute, char *dst, size_t dst_size) {
+/*
+ * if tail_at is non-NULL, it receives the offset in dst where any nonexistent
+ * tail of soft begins, or the returned length when all of dst exists
+ */
+static ssize_t physical_normpath_impl(int dirfd, const char *existing, const char *soft, int want_absolute, char *dst, size_t dst_size, size_t *tail_at, struct shared *shared) {
     if (!dst || dst_size == 0 || dst_size > PATH_MAX || dst_size > SSIZE_MAX) { errno = EINVAL; return -1; }
     if (!existing && !soft) { errno = EINVAL; return -1; }
     // TODO consider whether next two checks can be relaxed
     if ((existing && existing[0] == '\0') || (soft && soft[0] == '\0')) { errno = EINVAL; return -1; }
     size_t cursor = 0;
+    size_t soft_at = 0;
+    int did_soft = 0;
     int force_slash = 0;
     int soft_absolute = soft && soft[0] == '/';
     if (existing) {
@@ -274,27 +463,31 @@ ssize_t physical_normpath(int dirfd, const char *existing, const char *soft, int
         if (!soft_absolute)
 #endif
         {
-            size_t existing_len = strlen(existing);
-            assert(existing_len > 0);
-            struct stat existing_stat;
-            if (fstatat(dirfd, existing, &existing_stat, 0) != 0) {
-                return -1;
-            }
-            assert(!S_ISLNK(existing_stat.st_mode));
-            force_slash = S_ISDIR(existing_stat.st_mode);
+            if (shared) {
+                force_slash = shared->force_slash;
+            } else {
+                size_t existing_len = strlen(existing);
+                assert(existing_len > 0);
+                struct stat existing_stat;
+                if (fstatat(dirfd, existing, &existing_stat, 0) != 0) {
+                    return -1;
+                }
+                assert(!S_ISLNK(existing_stat.st_mode));
+                force_slash = S_ISDIR(existing_stat.st_mode);
 #if defined(__APPLE__) && defined(__MACH__)
-            if (!force_slash && existing[existing_len - 1] == '/') {
-                // "link_file/" on Darwin
-                errno = ENOTDIR; return -1;
-            }
+                if (!force_slash && existing[existing_len - 1] == '/') {
+                    // "link_file/" on Darwin
+                    errno = ENOTDIR; return -1;
+                }
 #endif
-            assert(existing[existing_len - 1] != '/' || force_slash == 1);
-            if (soft && !force_slash) { errno = ENOTDIR; return -1; }
+                assert(existing[existing_len - 1] != '/' || force_slash == 1);
+                if (soft && !force_slash) { errno = ENOTDIR; return -1; }
+            }
             if (!soft_absolute) {
-                ssize_t resolve_len = resolve(dirfd, existing, force_slash, 0, want_absolute, dst, cursor, dst_size);
+                ssize_t resolve_len = resolve(dirfd, existing, force_slash, 0, 0, 0, want_absolute, shared ? shared->dirpath : 0, dst, cursor, dst_size);
                 if (resolve_len < 0) return -1;
                 want_absolute = 0;
-                cursor += (size_t) resolve_len;
+                cursor = (size_t) resolve_len;
             }
         }
     } /* if (existing) */
@@ -306,17 +499,16 @@ ssize_t physical_normpath(int dirfd, const char *existing, const char *soft, int
             assert(dst[cursor - 1] != '/');
         }
     } else {
-        int did_soft = 0;
-
         // FIXME set force_slash
         size_t soft_len = strlen(soft);
         assert(soft_len > 0);
         if (soft[soft_len - 1] == '/' || (soft_len >= 2 && soft[soft_len - 2] == '/' && soft[soft_len - 1] == '.') || (soft_len >= 3 && soft[soft_len - 3] == '/' && soft[soft_len - 2] == '.' && soft[soft_len - 1] == '.'))
             force_slash = 1;
 
-        ssize_t resolve_len = resolve(dirfd, soft, force_slash, &did_soft, want_absolute, dst, cursor, dst_size);
+        // resolve returns the full length of dst, not just what it appended
+        ssize_t resolve_len = resolve(dirfd, soft, force_slash, &did_soft, &soft_at, shared ? &shared->covered : 0, want_absolute, shared ? shared->dirpath : 0, dst, cursor, dst_size);
         if (resolve_len < 0) return -1;
-        cursor += (size_t)resolve_len;
+        cursor = (size_t)resolve_len;
         assert(did_soft || cursor <= 1 || dst[cursor - 1] != '/');
         if (did_soft || cursor <= 1) {
             force_slash = 0;
@@ -347,7 +539,9 @@ ssize_t physical_normpath(int dirfd, const char *existing, const char *soft, int
         dst[0] = '.';
         dst[1] = '/';
         cursor += 2;
+        soft_at += 2;
     }
+    if (tail_at) *tail_at = did_soft ? soft_at : cursor;
     assert(cursor < dst_size);
     assert(dst[cursor] == '\0');
     return (ssize_t)cursor;
@@ -355,3 +549,161 @@ ssize_t physical_normpath(int dirfd, const char *existing, const char *soft, int
 toolong:
     errno = ENAMETOOLONG; return -1;
 }
+
+
+static ssize_t logical_normpath_traced(int dirfd, const char *existing, const char *soft, int want_absolute, char *dst, size_t dst_size, struct digest_stream *ds) {
+    PROBE4(logical_entry, dirfd, existing, soft, want_absolute);
+    HISTOGRAM_START(t0);
+    ssize_t result = logical_normpath_impl(dirfd, existing, soft, want_absolute, dst, dst_size, 0, ds);
+    HISTOGRAM_STOP(HIST_LOGICAL, t0);
+    PROBE_FAILURE(result, existing, soft);
+    PROBE3(logical_return, result, errno, dst);
+    return result;
+}
+
+ssize_t logical_normpath(int dirfd, const char *existing, const char *soft, int want_absolute, char *dst, size_t dst_size) {
+    return logical_normpath_traced(dirfd, existing, soft, want_absolute, dst, dst_size, 0);
+}
+
+ssize_t physical_normpath(int dirfd, const char *existing, const char *soft, int want_absolute, char *dst, size_t dst_size) {
+    PROBE4(physical_entry, dirfd, existing, soft, want_absolute);
+    HISTOGRAM_START(t0);
+    ssize_t result = physical_normpath_impl(dirfd, existing, soft, want_absolute, dst, dst_size, 0, 0);
+    HISTOGRAM_STOP(HIST_PHYSICAL, t0);
+    PROBE_FAILURE(result, existing, soft);
+    PROBE3(physical_return, result, errno, dst);
+    return result;
+}
+
+/*
+ * dst contains no symlinks, so any met while opening it mean it changed under us
+ * falls back to plain openat where openat2 is unavailable
+ */
+static int open_resolved(int dirfd, const char *path, int flags) {
+#if defined(__linux__) && defined(SYS_openat2) && defined(RESOLVE_NO_SYMLINKS)
+    struct open_how how = { .flags = (unsigned long long)flags, .resolve = RESOLVE_NO_SYMLINKS };
+    int fd = (int)syscall(SYS_openat2, dirfd, path, &how, sizeof(how));
+    if (fd >= 0 || errno != ENOSYS) return fd;
+#endif
+    return openat(dirfd, path, flags);
+}
+
+/*
+ * like physical_normpath, but also opens the deepest existing object named by dst:
+ * the final object itself or, when soft ends in components that don't exist yet,
+ * their last existing ancestor directory
+ * *tail_at receives the offset in dst where that nonexistent tail begins
+ * (the returned length when there is none), for use as openat(*fd_out, &dst[*tail_at], ...)
+ * open_flags apply only when the final object exists; -1 means O_PATH|O_CLOEXEC
+ * an ancestor is always opened O_PATH|O_DIRECTORY|O_CLOEXEC
+ * O_CREAT and O_TMPFILE are rejected, since the object opened always exists already
+ * on failure, *fd_out is -1 and nothing is left open
+ */
+ssize_t physical_normpath_open(int dirfd, const char *existing, const char *soft, int want_absolute, int open_flags, int *fd_out, size_t *tail_at, char *dst, size_t dst_size) {
+    if (!fd_out || !tail_at) { errno = EINVAL; return -1; }
+    *fd_out = -1;
+    if (open_flags == -1) {
+        open_flags = O_PATH | O_CLOEXEC;
+    } else if (open_flags & O_CREAT) {
+        errno = EINVAL; return -1;
+    }
+#ifdef O_TMPFILE
+    else if ((open_flags & O_TMPFILE) == O_TMPFILE) { errno = EINVAL; return -1; }
+#endif
+    PROBE4(physical_entry, dirfd, existing, soft, want_absolute);
+    HISTOGRAM_START(t0);
+    ssize_t result = physical_normpath_impl(dirfd, existing, soft, want_absolute, dst, dst_size, tail_at, 0);
+    if (result >= 0) {
+        size_t tail = *tail_at;
+        if (tail < (size_t)result) open_flags = O_PATH | O_DIRECTORY | O_CLOEXEC;
+        char sep = dst[tail];
+        dst[tail] = '\0';
+        int fd = open_resolved(dirfd, tail ? dst : ".", open_flags);
+        dst[tail] = sep;
+        if (fd < 0) result = -1;
+        else *fd_out = fd;
+    }
+    HISTOGRAM_STOP(HIST_PHYSICAL_OPEN, t0);
+    PROBE_FAILURE(result, existing, soft);
+    PROBE3(physical_return, result, errno, dst);
+    return result;
+}
+
+/*
+ * writes logical_normpath's result to logical_dst and physical_normpath's to physical_dst
+ * existing is validated and getdirpath(dirfd) fetched once for both, and the physical walk's
+ * readlinkat of each soft component stands in for the logical pass's check of it
+ * (EINVAL: exists, not a link; ENOENT: ends the walk, as it ends the checks)
+ * components after a .. that follows an expanded symlink are still checked separately
+ * returns 0 and sets *logical_len and *physical_len, or -1
+ */
+int dual_normpath(int dirfd, const char *existing, const char *soft, int want_absolute, char *logical_dst, size_t logical_size, ssize_t *logical_len, char *physical_dst, size_t physical_size, ssize_t *physical_len) {
+    if (!logical_len || !physical_len) { errno = EINVAL; return -1; }
+    if (!existing && !soft) { errno = EINVAL; return -1; }
+    if ((existing && existing[0] == '\0') || (soft && soft[0] == '\0')) { errno = EINVAL; return -1; }
+    PROBE4(dual_entry, dirfd, existing, soft, want_absolute);
+    HISTOGRAM_START(t0);
+    int result = -1;
+    int soft_absolute = soft && soft[0] == '/';
+    struct shared shared = { 0, 0, 0, 0 };
+    if (existing) {
+#if ABSOLUTE_SOFT_SHORT_CIRCUITS
+        if (!soft_absolute)
+#endif
+        {
+            int dangling = 0;
+            shared.force_slash = check_existing(dirfd, existing, soft, &dangling);
+            if (shared.force_slash < 0 || dangling) goto done;
+        }
+    }
+    // same condition as logical_normpath's; physical fetches its own if it turns out to need one
+    char dirpath[PATH_MAX];
+    if (want_absolute && !soft_absolute && !(existing && existing[0] == '/')) {
+        ssize_t path_len = getdirpath(dirfd, dirpath, sizeof(dirpath));
+        if (path_len < 0) goto done;
+        shared.dirpath = dirpath;
+        shared.dirpath_len = (size_t)path_len;
+    }
+    // the physical walk goes first, so the logical pass can reuse its lookups
+    *physical_len = physical_normpath_impl(dirfd, existing, soft, want_absolute, physical_dst, physical_size, 0, &shared);
+    if (*physical_len < 0) goto done;
+    *logical_len = logical_normpath_impl(dirfd, existing, soft, want_absolute, logical_dst, logical_size, &shared, 0);
+    if (*logical_len < 0) goto done;
+    result = 0;
+
+done:
+    HISTOGRAM_STOP(HIST_DUAL, t0);
+    PROBE_FAILURE(result, existing, soft);
+    PROBE4(dual_return, result, errno, logical_dst, physical_dst);
+    return result;
+}
+
+/*
+ * the *_digest variants also fill in digest for the result in dst
+ * offsets[i] is where component i starts, for i < offsets_cap; components counts them all
+ * the logical result is hashed as it is written
+ */
+ssize_t logical_normpath_digest(int dirfd, const char *existing, const char *soft, int want_absolute, char *dst, size_t dst_size, struct normpath_digest *digest) {
+    if (!digest || (digest->offsets_cap && !digest->offsets)) { errno = EINVAL; return -1; }
+    struct digest_stream ds;
+    digest_start(&ds, digest);
+    ssize_t result = logical_normpath_traced(dirfd, existing, soft, want_absolute, dst, dst_size, &ds);
+    if (result >= 0) digest_finish(&ds);
+    return result;
+}
+
+/*
+ * resolve() backs up over .. components and rewrites dst from a new base at each absolute
+ * symlink, so the physical result is digested in one pass over dst once it is final
+ */
+ssize_t physical_normpath_digest(int dirfd, const char *existing, const char *soft, int want_absolute, char *dst, size_t dst_size, struct normpath_digest *digest) {
+    if (!digest || (digest->offsets_cap && !digest->offsets)) { errno = EINVAL; return -1; }
+    ssize_t result = physical_normpath(dirfd, existing, soft, want_absolute, dst, dst_size);
+    if (result >= 0) {
+        struct digest_stream ds;
+        digest_start(&ds, digest);
+        digest_span(&ds, dst, 0, (size_t)result);
+        digest_finish(&ds);
+    }
+    return result;
+}
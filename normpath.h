@@ -1,4 +1,38 @@
 
+/*
+ * filled in by the *_digest variants for the path they write to dst
+ * offsets is caller-provided and may be NULL if offsets_cap is 0
+ */
+struct normpath_digest {
+    unsigned long long hash;
+    size_t *offsets;    // where each component starts in dst
+    size_t offsets_cap;
+    size_t components;  // count of all components, even past offsets_cap
+};
+
+extern ssize_t normal(const char *src, int force_slash, char *dst, size_t dst_size);
+extern ssize_t normal_digest(const char *src, int force_slash, char *dst, size_t dst_size, struct normpath_digest *digest);
 extern ssize_t logical_normpath(int dirfd, const char *existing, const char *soft, int want_absolute, char *dst, size_t dst_size);
 extern ssize_t physical_normpath(int dirfd, const char *existing, const char *soft, int want_absolute, char *dst, size_t dst_size);
+/*
+ * normal_digest and logical_normpath_digest hash dst as they write it
+ * physical_normpath_digest makes one pass over the finished dst instead,
+ * since resolve() backs up over .. components while writing
+ */
+extern ssize_t logical_normpath_digest(int dirfd, const char *existing, const char *soft, int want_absolute, char *dst, size_t dst_size, struct normpath_digest *digest);
+extern ssize_t physical_normpath_digest(int dirfd, const char *existing, const char *soft, int want_absolute, char *dst, size_t dst_size, struct normpath_digest *digest);
+/*
+ * logical and physical results from one walk; returns 0, or -1 if either would fail
+ * unlike logical_normpath, this fails when existing is a dangling or looping symlink
+ */
+extern int dual_normpath(int dirfd, const char *existing, const char *soft, int want_absolute, char *logical_dst, size_t logical_size, ssize_t *logical_len, char *physical_dst, size_t physical_size, ssize_t *physical_len);
+/*
+ * open_flags of -1 means O_PATH|O_CLOEXEC; see normpath.c for the full contract
+ * O_PATH is O_RDONLY on Darwin, so there the opened object must also be readable
+ */
+extern ssize_t physical_normpath_open(int dirfd, const char *existing, const char *soft, int want_absolute, int open_flags, int *fd_out, size_t *tail_at, char *dst, size_t dst_size);
+
 
+// -1 with ENOTSUP unless built with -DNORMPATH_HISTOGRAM=1; see trace.h
+extern int normpath_histogram_dump(int fd);
+extern void normpath_histogram_reset(void);
@@ -1,6 +1,7 @@
 #define _GNU_SOURCE
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <limits.h>
 #include <errno.h>
 #include <unistd.h>
@@ -8,6 +9,8 @@
 #include <assert.h>
 #include <stdio.h>
 
+#include "trace.h"
+
 #define SYMLOOP_MAX 40
 
 #if defined(__APPLE__) && defined(__MACH__)
@@ -30,10 +33,20 @@ static size_t slash_len(const char *s) {
 
 /* based on musl's implemtation of realpath */
 
-ssize_t resolve(int dirfd, const char *restrict src, int force_slash, int *can_soft, int want_absolute, char *restrict dst, size_t q, size_t dst_size) {
+/* When can_soft is non-NULL, a missing component ends the walk instead of
+ * failing: the rest of src is appended normalized, *can_soft is set, and,
+ * if soft_at is non-NULL, *soft_at receives the offset in dst where that
+ * nonexistent tail begins. A non-NULL dirpath stands in for getdirpath(dirfd).
+ * If covered is non-NULL, it receives how many leading components of src
+ * were looked up along the path the kernel would take for the same text,
+ * so a caller can reuse those lookups: SIZE_MAX for all of them, else the
+ * count before the first .. that follows an expanded symlink. */
+
+ssize_t resolve(int dirfd, const char *restrict src, int force_slash, int *can_soft, size_t *soft_at, size_t *covered, int want_absolute, const char *dirpath, char *restrict dst, size_t q, size_t dst_size) {
     char stack[PATH_MAX + 1];
-    size_t p, len, len0, symlink_cnt = 0, nup = 0;
-    int check_dir = 0;
+    size_t p, len, len0, symlink_cnt = 0, nup = 0, soft_q = 0;
+    size_t r, src_cnt = 0;
+    int check_dir = 0, diverged = 0;
 
     if (!src) {
         errno = EINVAL;
@@ -47,6 +60,9 @@ ssize_t resolve(int dirfd, const char *restrict src, int force_slash, int *can_s
     if (q + len >= dst_size) goto toolong;
     p = sizeof(stack) - len - 1;
     memcpy(stack + p, src, len + 1);
+    /* stack[r..] is what remains of src itself; anything before it
+     * was pushed from symlinks. */
+    r = p;
 
     /* Main loop. Each iteration pops the next part from stack of
      * remaining path components and consumes any slashes that follow.
@@ -76,6 +92,8 @@ restart:
             continue;
         }
 
+        int from_src = p >= r;
+
         /* Copy next component onto dst at least temporarily, to
          * call readlink, but wait to advance dst position until
          * determining it's not a link. */
@@ -91,6 +109,12 @@ restart:
         p += len;
         assert(stack + p == z);
 
+        if (from_src && len0) {
+            r = p;
+            if (symlink_cnt && len0 == 2 && stack[p - 2] == '.' && stack[p - 1] == '.') diverged = 1;
+            if (!diverged) src_cnt++;
+        }
+
         int up = 0;
         if (len0 == 2 && stack[p - 2] == '.' && stack[p - 1] == '.') {
             up = 1;
@@ -115,6 +139,7 @@ restart:
         }
         if (k < 0) {
             if (can_soft && errno == ENOENT) {
+                soft_q = q + (dst[q] == '/');
                 ssize_t norm_len = normal(stack + p - len, 0, dst + q, dst_size - q);
                 if (norm_len < 0) return -1;
                 q += (size_t) norm_len;
@@ -154,9 +179,12 @@ skip_readlink:
         /* If link contents end in /, strip any slashes already on
          * stack to avoid /->// or spurious toolong. */
         if (stack[k - 1] == '/') while (stack[p] == '/') p++;
+        if (p > r) r = p;
         p -= (size_t)k;
         memmove(stack + p, stack, (size_t)k);
 
+        PROBE3(resolve_restart, dst, k, symlink_cnt);
+
         /* Skip the stack advancement in case we have a new
          * absolute base path. */
         goto restart;
@@ -165,8 +193,13 @@ skip_readlink:
     dst[q] = 0;
 
     if (dst[0] != '/' && want_absolute) {
-        len = (size_t)getdirpath(dirfd, stack, sizeof(stack));
-        if ((ssize_t)len < 0) return -1;
+        if (dirpath) {
+            len = strlen(dirpath);
+            memcpy(stack, dirpath, len + 1);
+        } else {
+            len = (size_t)getdirpath(dirfd, stack, sizeof(stack));
+            if ((ssize_t)len < 0) return -1;
+        }
         /* Cancel any initial .. components. */
         p = 0;
         while (nup--) {
@@ -180,8 +213,11 @@ skip_readlink:
         memmove(dst + len, dst + p, q - p + 1);
         memcpy(dst, stack, len);
         q = len + q - p;
+        if (can_soft && *can_soft) soft_q = len + soft_q - p;
     }
 
+    if (soft_at && can_soft && *can_soft) *soft_at = soft_q;
+    if (covered) *covered = diverged ? src_cnt : SIZE_MAX;
     return (ssize_t)q;
 
 toolong:
@@ -30,9 +30,13 @@ int main(int argc, char *argv[]) {
     const char *existing = NULL;
     const char *soft = NULL;
     int dirfd = AT_FDCWD;
+    int histogram = 0;
+    int want_fd = 0;
+    int both = 0;
+    int want_digest = 0;
 
     int opt;
-    while ((opt = getopt(argc, argv, "lae:d:")) != -1) {
+    while ((opt = getopt(argc, argv, "laboxHe:d:")) != -1) {
         switch (opt) {
             case 'l':
                 logical = 1;
@@ -40,6 +44,18 @@ int main(int argc, char *argv[]) {
             case 'a':
                 want_absolute = 1;
                 break;
+            case 'b':
+                both = 1;
+                break;
+            case 'o':
+                want_fd = 1;
+                break;
+            case 'x':
+                want_digest = 1;
+                break;
+            case 'H':
+                histogram = 1;
+                break;
             case 'e':
                 existing = optarg;
                 break;
@@ -47,10 +63,14 @@ int main(int argc, char *argv[]) {
                 dirfd = parse_int(optarg);
                 break;
             default:
-                fprintf(stderr, "Usage: %s [-l] [-a] [-e existing] [soft...]\n", argv[0]);
+                fprintf(stderr, "Usage: %s [-l] [-b | -o | -x] [-a] [-H] [-e existing] [soft...]\n", argv[0]);
                 return 1;
         }
     }
+    if (logical + both + want_fd > 1 || both + want_fd + want_digest > 1) {
+        fprintf(stderr, "%s: -b, -o and -x are mutually exclusive, and -l combines only with -x\n", argv[0]);
+        return 1;
+    }
 
     if (optind < argc) {
         size_t len = 0;
@@ -71,19 +91,63 @@ int main(int argc, char *argv[]) {
     }
 
     char dst[PATH_MAX];
+    char physical_dst[PATH_MAX];
+    ssize_t physical_result = 0;
     ssize_t result;
-    if (logical) {
+    int fd = -1;
+    size_t tail_at = 0;
+    size_t offsets[64];
+    struct normpath_digest digest = { 0, offsets, sizeof(offsets) / sizeof(offsets[0]), 0 };
+    if (both) {
+        result = 0;
+        if (dual_normpath(dirfd, existing, soft, want_absolute, dst, sizeof(dst), &result, physical_dst, sizeof(physical_dst), &physical_result) < 0) result = -1;
+    } else if (want_fd) {
+        result = physical_normpath_open(dirfd, existing, soft, want_absolute, -1, &fd, &tail_at, dst, sizeof(dst));
+    } else if (want_digest) {
+        if (logical) {
+            result = logical_normpath_digest(dirfd, existing, soft, want_absolute, dst, sizeof(dst), &digest);
+        } else {
+            result = physical_normpath_digest(dirfd, existing, soft, want_absolute, dst, sizeof(dst), &digest);
+        }
+    } else if (logical) {
         result = logical_normpath(dirfd, existing, soft, want_absolute, dst, sizeof(dst));
     } else {
         result = physical_normpath(dirfd, existing, soft, want_absolute, dst, sizeof(dst));
     }
 
-    printf("Arguments: %s-e \"%s\" \"%s\"  => ", (want_absolute ? (logical ? "-la " : "-a ") : (logical ? "-l " : "")), existing, soft);
+    char flags[8];
+    char *f = flags;
+    *f++ = '-';
+    if (logical) *f++ = 'l';
+    if (both) *f++ = 'b';
+    if (want_fd) *f++ = 'o';
+    if (want_digest) *f++ = 'x';
+    if (want_absolute) *f++ = 'a';
+    if (f == flags + 1) f = flags;
+    else *f++ = ' ';
+    *f = '\0';
+    printf("Arguments: %s-e \"%s\" \"%s\"  => ", flags, existing, soft);
     if (result < 0) {
         printf("%s (%d)\n", strerror(errno), errno);
         return (int)result;
     }
 
     printf("Result: \"%s\" (%zd)\n", dst, result);
+    if (both) printf("Physical: \"%s\" (%zd)\n", physical_dst, physical_result);
+    if (want_fd) {
+        char fd_path[PATH_MAX];
+        char link[32];
+        snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+        ssize_t n = readlink(link, fd_path, sizeof(fd_path) - 1);
+        fd_path[n < 0 ? 0 : n] = '\0';
+        printf("Opened: \"%s\" tail \"%s\" (%zu)\n", fd_path, &dst[tail_at], tail_at);
+        close(fd);
+    }
+    if (want_digest) {
+        printf("Digest: %016llx (%zu components)", digest.hash, digest.components);
+        for (size_t i = 0; i < digest.components && i < digest.offsets_cap; i++) printf(" %zu", offsets[i]);
+        printf("\n");
+    }
+    if (histogram && normpath_histogram_dump(STDERR_FILENO) < 0) perror("normpath_histogram_dump");
     return 0;
 }
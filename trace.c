@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <errno.h>
+
+#include "trace.h"
+
+#if NORMPATH_HISTOGRAM
+
+// bucket i counts calls taking [2^i, 2^(i+1)) ns; bucket 0 also takes 0 ns
+#define HISTOGRAM_BUCKETS 64
+
+static unsigned long long histogram[HIST_COUNT][HISTOGRAM_BUCKETS];
+
+static const char *const histogram_names[HIST_COUNT] = {
+    [HIST_LOGICAL] = "logical_normpath",
+    [HIST_PHYSICAL] = "physical_normpath",
+    [HIST_PHYSICAL_OPEN] = "physical_normpath_open",
+    [HIST_DUAL] = "dual_normpath",
+};
+
+void histogram_record(int which, unsigned long long ns) {
+    int bucket = ns ? 63 - __builtin_clzll(ns) : 0;
+    __atomic_fetch_add(&histogram[which][bucket], 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * writes each non-empty histogram to fd, one "lo..hi ns: count" line per bucket
+ * counts are read without stopping writers, so a dump may straddle a call
+ * returns 0, or -1 with errno set by the failing write
+ */
+int normpath_histogram_dump(int fd) {
+    for (int which = 0; which < HIST_COUNT; which++) {
+        unsigned long long counts[HISTOGRAM_BUCKETS];
+        unsigned long long total = 0;
+        for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+            counts[i] = __atomic_load_n(&histogram[which][i], __ATOMIC_RELAXED);
+            total += counts[i];
+        }
+        if (!total) continue;
+        if (dprintf(fd, "%s (%llu calls):\n", histogram_names[which], total) < 0) return -1;
+        for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+            if (!counts[i]) continue;
+            unsigned long long lo = i ? 1ULL << i : 0;
+            unsigned long long hi = (i < 63 ? 1ULL << (i + 1) : 0) - 1;
+            if (dprintf(fd, "  %llu..%llu ns: %llu\n", lo, hi, counts[i]) < 0) return -1;
+        }
+    }
+    return 0;
+}
+
+void normpath_histogram_reset(void) {
+    for (int which = 0; which < HIST_COUNT; which++)
+        for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+            __atomic_store_n(&histogram[which][i], 0, __ATOMIC_RELAXED);
+}
+
+#else
+
+int normpath_histogram_dump(int fd) {
+    (void)fd;
+    errno = ENOTSUP; return -1;
+}
+
+void normpath_histogram_reset(void) {
+}
+
+#endif
@@ -0,0 +1,69 @@
+/*
+ * Static tracepoints and latency histograms. Both are compiled out unless
+ * built with -DNORMPATH_USDT=1 (needs <sys/sdt.h> from systemtap) and/or
+ * -DNORMPATH_HISTOGRAM=1.
+ *
+ * Probes, all under provider "normpath":
+ *   logical_entry(dirfd, existing, soft, want_absolute)
+ *   logical_return(result, errno, dst)   dst is only valid when result >= 0
+ *   physical_entry(dirfd, existing, soft, want_absolute)   also for physical_normpath_open
+ *   physical_return(result, errno, dst)  likewise
+ *   dual_entry(dirfd, existing, soft, want_absolute)
+ *   dual_return(result, errno, logical_dst, physical_dst)   likewise, for both
+ *   resolve_restart(dst, link_len, symlink_cnt)
+ *   getpath_entry(fd)
+ *   getpath_return(result, errno, dst)   likewise
+ *   toolong(function, existing, soft)   when a public function fails with ENAMETOOLONG
+ *   eloop(function, existing, soft)     likewise with ELOOP, from the kernel or from resolve
+ *
+ * e.g. bpftrace -e 'usdt:./test_cli:normpath:eloop { printf("%s %s %s\n", str(arg0), str(arg1), str(arg2)); }'
+ */
+
+#ifndef NORMPATH_TRACE_H
+#define NORMPATH_TRACE_H
+
+#ifndef NORMPATH_USDT
+#define NORMPATH_USDT 0
+#endif
+#ifndef NORMPATH_HISTOGRAM
+#define NORMPATH_HISTOGRAM 0
+#endif
+
+#if NORMPATH_USDT
+#include <sys/sdt.h>
+#define PROBE1(name, a) DTRACE_PROBE1(normpath, name, a)
+#define PROBE2(name, a, b) DTRACE_PROBE2(normpath, name, a, b)
+#define PROBE3(name, a, b, c) DTRACE_PROBE3(normpath, name, a, b, c)
+#define PROBE4(name, a, b, c, d) DTRACE_PROBE4(normpath, name, a, b, c, d)
+#include <errno.h>
+#define PROBE_FAILURE(result, existing, soft) do { \
+    if ((result) < 0 && errno == ENAMETOOLONG) PROBE3(toolong, __func__, existing, soft); \
+    else if ((result) < 0 && errno == ELOOP) PROBE3(eloop, __func__, existing, soft); \
+} while (0)
+#else
+#define PROBE1(name, a) do {} while (0)
+#define PROBE2(name, a, b) do {} while (0)
+#define PROBE3(name, a, b, c) do {} while (0)
+#define PROBE4(name, a, b, c, d) do {} while (0)
+#define PROBE_FAILURE(result, existing, soft) do {} while (0)
+#endif
+
+// one histogram per public entry point
+enum { HIST_LOGICAL, HIST_PHYSICAL, HIST_PHYSICAL_OPEN, HIST_DUAL, HIST_COUNT };
+
+#if NORMPATH_HISTOGRAM
+#include <time.h>
+extern void histogram_record(int which, unsigned long long ns);
+static inline unsigned long long histogram_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+#define HISTOGRAM_START(t) unsigned long long t = histogram_now()
+#define HISTOGRAM_STOP(which, t) histogram_record(which, histogram_now() - t)
+#else
+#define HISTOGRAM_START(t) do {} while (0)
+#define HISTOGRAM_STOP(which, t) do {} while (0)
+#endif
+
+#endif